@@ -0,0 +1,153 @@
+# frozen_string_literal: true
+
+require_relative "../test/server_configs"
+
+# Builds each server in release mode, drives it with the same native load
+# generator (bench/loadgen.cpp) and prints throughput, p99 and worst-case
+# latency and RSS side by side.
+#
+# Tweak with environment variables:
+#   SERVERS=c,cpp         only benchmark these servers
+#   BENCH_CLIENTS=16      concurrent connections
+#   BENCH_REQUESTS=100000 total requests per server
+#   BENCH_KEYS=10000      keyspace size
+#   BENCH_SET_RATIO=0.5   fraction of SETs
+#   BENCH_DEL_RATIO=0     fraction of DELs, the rest are GETs
+#   BENCH_PREFILL=0       1 to SET every key before the timed run
+#
+# A delete-heavy churn run, where "end RSS" shows how much memory a server
+# hands back once most keys are gone. It needs enough requests to delete
+# most of the prefilled keys:
+#   BENCH_KEYS=500000 BENCH_PREFILL=1 BENCH_SET_RATIO=0.1 BENCH_DEL_RATIO=0.8 \
+#   BENCH_REQUESTS=2000000 rake bench
+#
+# A SET-only run over a growing keyspace, where "max" shows whether any
+# single command stalls while the table resizes:
+#   BENCH_KEYS=1000000 BENCH_SET_RATIO=1 BENCH_REQUESTS=2000000 rake bench
+module Bench
+  ROOT = File.expand_path("..", __dir__)
+  LOADGEN = File.join(ROOT, "bench", "loadgen")
+  LOADGEN_OPTIONS = {
+    "BENCH_CLIENTS" => "--clients",
+    "BENCH_REQUESTS" => "--requests",
+    "BENCH_KEYS" => "--keys",
+    "BENCH_SET_RATIO" => "--set-ratio",
+    "BENCH_DEL_RATIO" => "--del-ratio",
+    "BENCH_PREFILL" => "--prefill",
+  }.freeze
+  # How long the server gets to finish background work (e.g. shrinking
+  # and trimming) after the run before "end RSS" is read.
+  SETTLE_SECONDS = 1
+
+  module_function
+
+  def run
+    Dir.chdir(ROOT) do
+      abort "failed to build the load generator" unless system("make -C bench")
+
+      results = server_names.map do |name|
+        puts "==> #{ name }"
+        [name, bench(SERVER_CONFIGS.fetch(name))]
+      end
+      print_table(results)
+    end
+  end
+
+  def server_names
+    return SERVER_CONFIGS.keys unless ENV["SERVERS"]
+
+    names = ENV["SERVERS"].split(",").map(&:strip).map(&:downcase)
+    unknown = names - SERVER_CONFIGS.keys
+    abort "Unknown servers: #{ unknown.join(', ') }, valid options: #{ SERVER_CONFIGS.keys.join(', ') }" if unknown.any?
+    names
+  end
+
+  def loadgen_args
+    LOADGEN_OPTIONS.flat_map { |env, flag| ENV[env] ? [flag, ENV[env]] : [] }
+  end
+
+  def bench(config)
+    build = config["release_build"] || config["build"]
+    return { "error" => "build failed" } if build && !system(build)
+
+    pid = nil
+    start = config["release_start"] || config["start"]
+    begin
+      pid = spawn(*start, PORT, out: File::NULL, err: File::NULL)
+    rescue SystemCallError => e
+      return { "error" => e.message }
+    end
+    begin
+      wait_for_listener(timeout: 30)
+    rescue Timeout::Error
+      return { "error" => "did not start" }
+    end
+
+    output = IO.popen([LOADGEN, "--port", PORT, *loadgen_args], &:read)
+    result = output.split.to_h { |pair| pair.split("=", 2) }
+    return { "error" => "load generator failed (exit #{ $?.exitstatus })" } unless result["ops_per_sec"]
+
+    result["peak_rss_kb"], = rss_kb(pid)
+    sleep SETTLE_SECONDS
+    _, result["end_rss_kb"] = rss_kb(pid)
+    result
+  ensure
+    if pid
+      Process.kill("KILL", pid)
+      Process.wait(pid)
+    end
+  end
+
+  # Block until a socket is listening on PORT. Unlike wait_for_server this
+  # never connects: the C server dies of SIGPIPE once any client
+  # disconnects, so a probe connection would kill it before the run.
+  # Linux only, elsewhere fall back to wait_for_server.
+  def wait_for_listener(timeout:)
+    return wait_for_server(timeout: timeout) unless File.exist?("/proc/net/tcp")
+
+    port = format(":%04X", PORT.to_i)
+    Timeout.timeout(timeout) do
+      sleep 0.01 until listening?(port)
+    end
+  end
+
+  # Whether /proc/net/tcp{,6} has a socket in the LISTEN state (0A) whose
+  # local address ends with port.
+  def listening?(port)
+    %w[/proc/net/tcp /proc/net/tcp6].any? do |path|
+      File.readlines(path).drop(1).any? do |line|
+        _, local, _, state = line.split
+        local.end_with?(port) && state == "0A"
+      end
+    rescue Errno::ENOENT
+      false
+    end
+  end
+
+  # High water mark and current size of the resident set, Linux only.
+  def rss_kb(pid)
+    status = File.read("/proc/#{ pid }/status")
+    [status[/^VmHWM:\s+(\d+) kB/, 1]&.to_i, status[/^VmRSS:\s+(\d+) kB/, 1]&.to_i]
+  rescue Errno::ENOENT
+    [nil, nil]
+  end
+
+  def print_table(results)
+    row = "%-10s %12s %12s %12s %15s %14s %8s\n"
+    puts
+    printf(row, "server", "ops/sec", "p99 (ms)", "max (ms)", "peak RSS (MB)", "end RSS (MB)", "errors")
+    results.each do |name, result|
+      if result["error"]
+        printf("%-10s %s\n", name, result["error"])
+        next
+      end
+
+      # Nothing completed, e.g. the server died: there is no latency to show.
+      p99, max = result.values_at("p99_us", "max_us").map do |us|
+        us && result["requests"] != "0" && format("%.3f", us.to_i / 1000.0)
+      end
+      peak_rss, end_rss = result.values_at("peak_rss_kb", "end_rss_kb").map { |kb| kb && format("%.1f", kb / 1024.0) }
+      printf(row, name, result["ops_per_sec"] || "-", p99 || "-", max || "-", peak_rss || "-", end_rss || "-", result["errors"] || "-")
+    end
+  end
+end
@@ -0,0 +1,387 @@
+#include <arpa/inet.h>  // For inet_pton, htons
+#include <errno.h>      // For errno
+#include <netinet/in.h> // For sockaddr_in
+#include <netinet/tcp.h> // For TCP_NODELAY
+#include <stdio.h>      // For printf, fprintf
+#include <stdlib.h>     // For atoi, atof, exit
+#include <string.h>     // For strcmp, memset
+#include <sys/epoll.h>  // For epoll_create1, epoll_ctl, epoll_wait
+#include <sys/socket.h> // For socket, connect, send, recv
+#include <unistd.h>     // For close, usleep
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Closed-loop load generator for the line protocol every server here
+// speaks: each connection sends one GET, SET or DEL, waits for the reply
+// line, records the round trip and sends the next one. Prints a single
+// line of key=value results so the Rakefile can parse it.
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+  const char *host = "127.0.0.1";
+  int port = 3000;
+  int clients = 16;
+  long requests = 100000;  // total, across all connections
+  long keys = 10000;       // size of the keyspace
+  double set_ratio = 0.5;  // fraction of commands that are SET
+  double del_ratio = 0.0;  // fraction of commands that are DEL, the rest are GET
+  bool prefill = false;    // SET every key once before the timed run
+  int timeout = 60;        // seconds before giving up on the run
+};
+
+struct Connection
+{
+  int fd = -1;
+  std::string out;
+  size_t out_pos = 0;
+  std::string in;
+  Clock::time_point sent_at;
+  bool busy = false; // a request is in flight
+};
+
+static void usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [--host ip] [--port n] [--clients n] [--requests n]"
+          " [--keys n] [--set-ratio r] [--del-ratio r] [--prefill 0|1]"
+          " [--timeout seconds]\n",
+          program);
+  exit(1);
+}
+
+static Options parse_options(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i += 2)
+  {
+    if (i + 1 >= argc)
+    {
+      usage(argv[0]);
+    }
+    const char *name = argv[i];
+    const char *value = argv[i + 1];
+    if (strcmp(name, "--host") == 0)
+    {
+      options.host = value;
+    }
+    else if (strcmp(name, "--port") == 0)
+    {
+      options.port = atoi(value);
+    }
+    else if (strcmp(name, "--clients") == 0)
+    {
+      options.clients = atoi(value);
+    }
+    else if (strcmp(name, "--requests") == 0)
+    {
+      options.requests = atol(value);
+    }
+    else if (strcmp(name, "--keys") == 0)
+    {
+      options.keys = atol(value);
+    }
+    else if (strcmp(name, "--set-ratio") == 0)
+    {
+      options.set_ratio = atof(value);
+    }
+    else if (strcmp(name, "--del-ratio") == 0)
+    {
+      options.del_ratio = atof(value);
+    }
+    else if (strcmp(name, "--prefill") == 0)
+    {
+      options.prefill = atoi(value) != 0;
+    }
+    else if (strcmp(name, "--timeout") == 0)
+    {
+      options.timeout = atoi(value);
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+  if (options.clients < 1 || options.requests < 1 || options.keys < 1 ||
+      options.set_ratio < 0 || options.del_ratio < 0 || options.set_ratio + options.del_ratio > 1)
+  {
+    usage(argv[0]);
+  }
+  return options;
+}
+
+// Connect with a blocking socket, retrying up to attempts times since some
+// servers only accept one connection per loop iteration with a tiny
+// backlog. Return -1 if every attempt failed.
+static int connect_to(const Options &options, int attempts)
+{
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  if (inet_pton(AF_INET, options.host, &address.sin_addr) != 1)
+  {
+    fprintf(stderr, "invalid host: %s\n", options.host);
+    exit(1);
+  }
+
+  for (int attempt = 0; attempt < attempts; attempt++)
+  {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+      perror("socket");
+      exit(1);
+    }
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) == 0)
+    {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  perror("connect");
+  return -1;
+}
+
+// SET every key of the keyspace over one connection, one at a time, so a
+// delete-heavy run starts from a full table and exercises the shrink path.
+// Return false if the connection broke along the way.
+static bool prefill(int fd, const Options &options)
+{
+  std::string in;
+  for (long key = 0; key < options.keys; key++)
+  {
+    std::string command = "SET key:" + std::to_string(key) + " " + std::to_string(key) + "\n";
+    if (send(fd, command.data(), command.size(), MSG_NOSIGNAL) != (ssize_t)command.size())
+    {
+      perror("prefill send");
+      return false;
+    }
+    while (in.find('\n') == std::string::npos)
+    {
+      char buffer[256];
+      ssize_t res = recv(fd, buffer, sizeof(buffer), 0);
+      if (res <= 0)
+      {
+        fprintf(stderr, "server closed the connection during prefill\n");
+        return false;
+      }
+      in.append(buffer, res);
+    }
+    in.erase(0, in.find('\n') + 1);
+  }
+  return true;
+}
+
+static long percentile(std::vector<long> &values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+int main(int argc, char **argv)
+{
+  Options options = parse_options(argc, argv);
+  std::mt19937_64 random(42);
+  std::uniform_int_distribution<long> key_distribution(0, options.keys - 1);
+  std::uniform_real_distribution<double> ratio_distribution(0.0, 1.0);
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0)
+  {
+    perror("epoll_create1");
+    exit(1);
+  }
+
+  // A server that dies or refuses connections shows up as errors in the
+  // results rather than aborting the run, so it still gets a row.
+  long errors = 0;
+  long connect_errors = 0;
+  bool prefilled = !options.prefill;
+  std::vector<Connection> connections(options.clients);
+  for (size_t i = 0; i < connections.size(); i++)
+  {
+    // Once a connection has failed every retry the server is most likely
+    // gone, don't spend another second per remaining connection on it.
+    int fd = connect_to(options, connect_errors > 0 ? 1 : 100);
+    if (fd < 0)
+    {
+      connect_errors++;
+      continue;
+    }
+    if (!prefilled)
+    {
+      if (!prefill(fd, options))
+      {
+        close(fd);
+        errors++;
+        continue;
+      }
+      prefilled = true;
+    }
+    connections[i].fd = fd;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = i;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+  errors += connect_errors;
+
+  std::vector<long> latencies_us;
+  latencies_us.reserve(options.requests);
+  long sent = 0;
+  long completed = 0;
+
+  // Stop using a connection the server closed or broke, failing whatever
+  // request was in flight on it.
+  auto drop = [&](Connection &conn)
+  {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    conn.fd = -1;
+    if (conn.busy)
+    {
+      errors++;
+      completed++;
+    }
+    conn.busy = false;
+  };
+
+  // Queue the next command on conn and push out as much as the socket takes.
+  auto send_next = [&](Connection &conn)
+  {
+    long key = key_distribution(random);
+    double choice = ratio_distribution(random);
+    if (choice < options.set_ratio)
+    {
+      conn.out = "SET key:" + std::to_string(key) + " " + std::to_string(sent) + "\n";
+    }
+    else if (choice < options.set_ratio + options.del_ratio)
+    {
+      conn.out = "DEL key:" + std::to_string(key) + "\n";
+    }
+    else
+    {
+      conn.out = "GET key:" + std::to_string(key) + "\n";
+    }
+    conn.out_pos = 0;
+    conn.busy = true;
+    conn.sent_at = Clock::now();
+    sent++;
+    while (conn.out_pos < conn.out.size())
+    {
+      ssize_t res = send(conn.fd, conn.out.data() + conn.out_pos,
+                         conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+      if (res < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        perror("send");
+        drop(conn);
+        return;
+      }
+      conn.out_pos += res;
+    }
+  };
+
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + std::chrono::seconds(options.timeout);
+  for (Connection &conn : connections)
+  {
+    if (conn.fd >= 0 && sent < options.requests)
+    {
+      send_next(conn);
+    }
+  }
+
+  epoll_event events[64];
+  while (completed < sent)
+  {
+    if (Clock::now() > deadline)
+    {
+      fprintf(stderr, "timed out with %ld requests outstanding\n", sent - completed);
+      errors += sent - completed;
+      break;
+    }
+    int n = epoll_wait(epoll_fd, events, 64, 100);
+    if (n < 0 && errno != EINTR)
+    {
+      perror("epoll_wait");
+      exit(1);
+    }
+    for (int i = 0; i < n; i++)
+    {
+      Connection &conn = connections[events[i].data.u32];
+      if (conn.fd < 0)
+      {
+        continue;
+      }
+      char buffer[4096];
+      ssize_t res = recv(conn.fd, buffer, sizeof(buffer), 0);
+      if (res <= 0)
+      {
+        if (res < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        fprintf(stderr, "server closed a connection\n");
+        drop(conn);
+        continue;
+      }
+      conn.in.append(buffer, res);
+
+      size_t newline;
+      while (conn.busy && (newline = conn.in.find('\n')) != std::string::npos)
+      {
+        Clock::time_point now = Clock::now();
+        if (conn.in.compare(0, 3, "ERR") == 0)
+        {
+          errors++;
+        }
+        conn.in.erase(0, newline + 1);
+        latencies_us.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - conn.sent_at).count());
+        conn.busy = false;
+        completed++;
+        if (sent < options.requests)
+        {
+          send_next(conn);
+        }
+      }
+    }
+  }
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  for (Connection &conn : connections)
+  {
+    if (conn.fd >= 0)
+    {
+      close(conn.fd);
+    }
+  }
+  close(epoll_fd);
+
+  long p50 = percentile(latencies_us, 0.50);
+  long p99 = percentile(latencies_us, 0.99);
+  long max = latencies_us.empty() ? 0 : *std::max_element(latencies_us.begin(), latencies_us.end());
+  printf("requests=%zu errors=%ld connect_errors=%ld seconds=%.3f ops_per_sec=%.0f"
+         " p50_us=%ld p99_us=%ld max_us=%ld\n",
+         latencies_us.size(), errors, connect_errors, elapsed, latencies_us.size() / elapsed,
+         p50, p99, max);
+  return errors == 0 ? 0 : 2;
+}
@@ -1,7 +1,1359 @@
-#include <iostream>
-using namespace std;
- 
-int main() {
-   cout << "Hello, world!" << endl;
-   return 0;
+#include <arpa/inet.h>  // For htonl, htons
+#include <errno.h>      // For errno
+#include <limits.h>     // For INT_MAX, LLONG_MAX
+#include <fcntl.h>      // For open, O_RDONLY
+#include <malloc.h>     // For malloc_trim
+#include <netinet/in.h> // For sockaddr_in, INADDR_ANY
+#include <signal.h>     // For signal, SIGINT, SIGPIPE
+#include <stdio.h>      // For printf, perror
+#include <stdlib.h>     // For exit
+#include <string.h>     // For memset, strcmp, strncmp
+#include <time.h>       // For clock_gettime
+#include <sys/epoll.h>  // For epoll_create1, epoll_ctl, epoll_wait
+#include <sys/mman.h>   // For mmap, munmap
+#include <sys/resource.h> // For getrlimit, setrlimit
+#include <sys/socket.h> // For socket, bind, listen, accept, send
+#include <unistd.h>     // For close, read
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+static constexpr int DEFAULT_PORT = 3000;
+static constexpr size_t READ_CHUNK = 16 * 1024;
+static constexpr size_t MAX_INLINE = 64 * 1024; // longest command line we accept
+static constexpr int MAX_EVENTS = 128;
+static constexpr int CRON_INTERVAL_MS = 100;    // how often background work runs
+static constexpr long CRON_REHASH_US = 1000;    // rehash time budget per cron tick
+static constexpr size_t CRON_REHASH_BATCH = 1000; // buckets between clock checks
+static constexpr long long SCAN_DEFAULT_COUNT = 10;
+static constexpr long long SCAN_MAX_COUNT = 1000; // caps the work of one SCAN call
+static constexpr int MAX_ACCEPTS_PER_CALL = 1000;
+static constexpr long WHEEL_SLOTS = 64;          // must be a power of two
+static constexpr size_t DEFAULT_MAX_CLIENTS = 10000;
+static constexpr long DEFAULT_IDLE_TIMEOUT = 300; // seconds
+static constexpr long MAX_IDLE_TIMEOUT = 10L * 365 * 24 * 3600;
+static constexpr size_t DEFAULT_OUTPUT_LIMIT = 32 * 1024 * 1024;
+static constexpr size_t OUTPUT_COMPACT_THRESHOLD = 64 * 1024; // sent bytes worth dropping
+static constexpr uint64_t FNV_OFFSET = 14695981039346656037UL;
+static constexpr uint64_t FNV_PRIME = 1099511628211UL;
+static constexpr size_t INITIAL_CAPACITY = 16; // must be a power of two
+static constexpr size_t REHASH_BUCKETS = 4;    // buckets migrated per operation while growing
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void int_handler(int)
+{
+  keep_running = 0;
+}
+
+// Parse a number that spans the whole string.
+template <typename T>
+static bool parse_number(std::string_view string, T *result)
+{
+  auto [end, error] = std::from_chars(string.data(), string.data() + string.size(), *result);
+  return error == std::errc() && end == string.data() + string.size();
+}
+
+static long monotonic_us()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long monotonic_ms()
+{
+  return monotonic_us() / 1000;
+}
+
+// Return 64-bit FNV-1a hash for key. See description:
+// https://en.wikipedia.org/wiki/Fowler–Noll–Vo_hash_function
+static uint64_t hash_key(std::string_view key)
+{
+  uint64_t hash = FNV_OFFSET;
+  for (unsigned char c : key)
+  {
+    hash ^= (uint64_t)c;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// A key and its value. Slots only point at these, so moving an entry
+// around the table (or to the other table while resizing) is a few words.
+struct Item
+{
+  std::string key;
+  std::string value;
+};
+
+// One slot of a Robin Hood table. distance is the probe sequence length
+// plus one, so that zero can mean "empty" without a separate flag. A slot
+// is all zeros when empty, so a new table can be fresh anonymous pages
+// from mmap, which the kernel only zeroes as they are first touched:
+// allocating even a huge table costs next to nothing up front.
+struct Slot
+{
+  uint64_t hash;
+  uint32_t distance;
+  Item *item;
+};
+
+// A single open-addressing array using Robin Hood linear probing. Entries
+// of a cluster are kept ordered by home bucket, which is what lets deletes
+// stop early (backward shift ends at the first entry sitting in its home
+// slot) and lets us walk "all entries whose home is bucket b" cheaply.
+// Capacity is always a power of two so wrapping is a mask, not a modulo.
+struct Table
+{
+  Slot *slots = nullptr;
+  size_t mask = 0;
+  size_t length = 0;
+
+  Table() = default;
+  Table(const Table &) = delete;
+  Table &operator=(const Table &) = delete;
+
+  Table(Table &&other) noexcept
+  {
+    *this = std::move(other);
+  }
+
+  Table &operator=(Table &&other) noexcept
+  {
+    std::swap(slots, other.slots);
+    std::swap(mask, other.mask);
+    std::swap(length, other.length);
+    other.release();
+    return *this;
+  }
+
+  ~Table()
+  {
+    release();
+  }
+
+  size_t capacity() const
+  {
+    return slots == nullptr ? 0 : mask + 1;
+  }
+
+  // Map fresh pages rather than calloc: after mass deletes malloc would
+  // recycle freed heap memory, which it then has to zero, page faults and
+  // all, inside the command that starts the resize.
+  void allocate(size_t capacity)
+  {
+    release();
+    void *memory = mmap(nullptr, capacity * sizeof(Slot), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(EXIT_FAILURE);
+    }
+    slots = (Slot *)memory;
+    mask = capacity - 1;
+  }
+
+  // Unmap the slot array and free any items still in it. A table retired
+  // by a finished rehash is empty, so this is just the munmap.
+  void release()
+  {
+    for (size_t i = 0; length > 0 && i < capacity(); i++)
+    {
+      if (slots[i].distance != 0)
+      {
+        delete slots[i].item;
+        length--;
+      }
+    }
+    if (slots != nullptr)
+    {
+      munmap(slots, capacity() * sizeof(Slot));
+    }
+    slots = nullptr;
+    mask = 0;
+    length = 0;
+  }
+
+  // Return slot index holding key, or -1 if absent. The probe stops as
+  // soon as it reaches an entry closer to its home than we are to ours,
+  // since Robin Hood ordering means key can't be any further along.
+  long find(std::string_view key, uint64_t hash) const
+  {
+    if (slots == nullptr)
+    {
+      return -1;
+    }
+    size_t index = hash & mask;
+    for (uint32_t distance = 1;; distance++)
+    {
+      const Slot &slot = slots[index];
+      if (slot.distance < distance)
+      {
+        return -1;
+      }
+      if (slot.hash == hash && slot.item->key == key)
+      {
+        return (long)index;
+      }
+      index = (index + 1) & mask;
+    }
+  }
+
+  // Insert an item whose key is known not to be present, taking ownership
+  // of it. Richer entries (shorter probe distance) give up their slot to
+  // poorer ones.
+  void insert(uint64_t hash, Item *item)
+  {
+    Slot carry = {hash, 1, item};
+    size_t index = hash & mask;
+    while (true)
+    {
+      Slot &slot = slots[index];
+      if (slot.distance == 0)
+      {
+        slot = carry;
+        length++;
+        return;
+      }
+      if (slot.distance < carry.distance)
+      {
+        std::swap(slot, carry);
+      }
+      index = (index + 1) & mask;
+      carry.distance++;
+    }
+  }
+
+  // Remove the entry at index with backward-shift deletion and hand its
+  // item to the caller: pull the following entries back by one until we
+  // hit an empty slot or an entry already in its home slot. The walk is
+  // bounded by the displacement of the cluster, not its length, and leaves
+  // no tombstones behind.
+  Item *remove_at(size_t index)
+  {
+    Item *item = slots[index].item;
+    size_t next = (index + 1) & mask;
+    while (slots[next].distance > 1)
+    {
+      slots[index] = slots[next];
+      slots[index].distance--;
+      index = next;
+      next = (next + 1) & mask;
+    }
+    slots[index] = {};
+    length--;
+    return item;
+  }
+
+  // Call fn(key) for every entry whose home is bucket. Thanks to Robin
+  // Hood ordering those entries are contiguous, starting at or after
+  // bucket, so this is the open-addressing equivalent of a chain.
+  template <typename F>
+  void visit_bucket(size_t bucket, F &&fn) const
+  {
+    size_t index = bucket;
+    uint32_t distance = 1;
+    while (slots[index].distance != 0 && slots[index].distance >= distance)
+    {
+      if (slots[index].distance == distance)
+      {
+        fn(slots[index].item->key);
+      }
+      index = (index + 1) & mask;
+      distance++;
+    }
+  }
+
+  // Move every entry whose home is bucket into dest.
+  void migrate_bucket(size_t bucket, Table &dest)
+  {
+    size_t index = bucket;
+    uint32_t distance = 1;
+    while (slots[index].distance != 0 && slots[index].distance >= distance)
+    {
+      if (slots[index].distance == distance)
+      {
+        uint64_t hash = slots[index].hash;
+        dest.insert(hash, remove_at(index));
+        // The next entry (if any) has shifted into index, re-check it.
+        continue;
+      }
+      // Entry from an earlier bucket that spilled over, skip it.
+      index = (index + 1) & mask;
+      distance++;
+    }
+  }
+};
+
+// Key/value store made of two Robin Hood tables, in the spirit of Redis'
+// dict: resizing allocates ht[1] and buckets are moved over a few at a
+// time on every operation (and from the server cron) rather than all at
+// once, so no single command pays for a full rehash. The table grows at
+// 75% load and shrinks by half once it drops below 12.5%, so memory is
+// handed back after mass deletes.
+class Dict
+{
+public:
+  Dict()
+  {
+    ht[0].allocate(INITIAL_CAPACITY);
+  }
+
+  size_t length() const
+  {
+    return ht[0].length + ht[1].length;
+  }
+
+  size_t capacity() const
+  {
+    return ht[0].capacity() + ht[1].capacity();
+  }
+
+  bool rehashing() const
+  {
+    return rehash_index >= 0;
+  }
+
+  // Return a pointer to the value for key, or nullptr if key is absent.
+  // The pointer is only valid until the next call on this Dict.
+  const std::string *get(std::string_view key)
+  {
+    rehash_step();
+    uint64_t hash = hash_key(key);
+    for (Table &table : ht)
+    {
+      long index = table.find(key, hash);
+      if (index >= 0)
+      {
+        return &table.slots[index].item->value;
+      }
+    }
+    return nullptr;
+  }
+
+  // Insert key or overwrite its value.
+  void set(std::string_view key, std::string value)
+  {
+    rehash_step();
+    uint64_t hash = hash_key(key);
+    for (Table &table : ht)
+    {
+      long index = table.find(key, hash);
+      if (index >= 0)
+      {
+        table.slots[index].item->value = std::move(value);
+        return;
+      }
+    }
+
+    if (!rehashing() && ht[0].length + 1 > ht[0].capacity() / 4 * 3)
+    {
+      start_rehash(ht[0].capacity() * 2);
+    }
+    // While rehashing new keys only go to ht[1], so ht[0] only drains.
+    Table &dest = rehashing() ? ht[1] : ht[0];
+    dest.insert(hash, new Item{std::string(key), std::move(value)});
+  }
+
+  // Remove key, return true if it was present.
+  bool del(std::string_view key)
+  {
+    rehash_step();
+    uint64_t hash = hash_key(key);
+    for (Table &table : ht)
+    {
+      long index = table.find(key, hash);
+      if (index >= 0)
+      {
+        delete table.remove_at(index);
+        shrink_if_needed();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Background work for the server cron, like Redis' dictRehashMilliseconds:
+  // migrate buckets in batches for up to budget_us microseconds, starting
+  // the next shrink as soon as one finishes, so an idle server gets from a
+  // large sparse table down to its right size in a few ticks instead of
+  // one halving per thousand buckets. Tables retired by finished rehashes
+  // are unmapped here too. Returns true when a shrink completed since the
+  // last call, whether here or during a command, i.e. when it's worth
+  // asking malloc to hand freed pages back to the OS.
+  bool cron(long budget_us)
+  {
+    long deadline = monotonic_us() + budget_us;
+    do
+    {
+      shrink_if_needed();
+      if (!rehashing())
+      {
+        break;
+      }
+      rehash(CRON_REHASH_BATCH);
+    } while (monotonic_us() < deadline);
+    retired.clear();
+    bool shrunk = shrink_finished;
+    shrink_finished = false;
+    return shrunk;
+  }
+
+  // Visit one bucket's worth of keys starting at cursor and return the
+  // cursor to resume from, 0 once the whole keyspace has been covered.
+  // This is Redis' dictScan: the cursor is incremented with its bits
+  // reversed, so the high bits (the ones a resize adds or removes from the
+  // mask) vary slowest. Every key present for the whole scan is returned
+  // at least once no matter how often the table grows or shrinks between
+  // calls, at the cost of possibly returning some keys more than once.
+  // *buckets is incremented by the number of buckets visited, which is
+  // more than one while a rehash is running.
+  template <typename F>
+  uint64_t scan(uint64_t cursor, F &&fn, size_t *buckets) const
+  {
+    if (!rehashing())
+    {
+      uint64_t mask = ht[0].mask;
+      ht[0].visit_bucket(cursor & mask, fn);
+      (*buckets)++;
+      return next_cursor(cursor, mask);
+    }
+
+    const Table *small = &ht[0];
+    const Table *large = &ht[1];
+    if (small->capacity() > large->capacity())
+    {
+      std::swap(small, large);
+    }
+    uint64_t small_mask = small->mask;
+    uint64_t large_mask = large->mask;
+
+    // Visit the bucket in the small table, then every bucket of the large
+    // table that it expands to.
+    small->visit_bucket(cursor & small_mask, fn);
+    (*buckets)++;
+    do
+    {
+      large->visit_bucket(cursor & large_mask, fn);
+      (*buckets)++;
+      cursor = next_cursor(cursor, large_mask);
+    } while (cursor & (small_mask ^ large_mask));
+    return cursor;
+  }
+
+private:
+  Table ht[2];
+  std::vector<Table> retired; // emptied by a finished rehash, freed by cron()
+  long rehash_index = -1; // next ht[0] bucket to migrate, -1 when idle
+  bool shrink_finished = false; // reported and reset by cron()
+
+  static uint64_t reverse_bits(uint64_t v)
+  {
+    uint64_t result = 0;
+    for (int i = 0; i < 64; i++)
+    {
+      result = (result << 1) | (v & 1);
+      v >>= 1;
+    }
+    return result;
+  }
+
+  // Increment the bits of cursor covered by mask, most significant first.
+  static uint64_t next_cursor(uint64_t cursor, uint64_t mask)
+  {
+    cursor |= ~mask;
+    cursor = reverse_bits(cursor);
+    cursor++;
+    return reverse_bits(cursor);
+  }
+
+  void start_rehash(size_t capacity)
+  {
+    ht[1].allocate(capacity);
+    rehash_index = 0;
+  }
+
+  void shrink_if_needed()
+  {
+    if (!rehashing() && ht[0].capacity() > INITIAL_CAPACITY &&
+        ht[0].length < ht[0].capacity() / 8)
+    {
+      // Halving (rather than jumping straight to the ideal size) keeps
+      // the per-operation migration rate constant, see rehash_step.
+      start_rehash(ht[0].capacity() / 2);
+    }
+  }
+
+  // Migrate enough buckets that ht[0] is empty before ht[1] can get past
+  // half full: growing moves 4 buckets per operation, shrinking (where
+  // ht[0] has twice as many buckets as ht[1]) moves 8.
+  void rehash_step()
+  {
+    if (rehashing())
+    {
+      size_t ratio = ht[0].capacity() > ht[1].capacity() ? 2 : 1;
+      rehash(REHASH_BUCKETS * ratio);
+    }
+  }
+
+  void rehash(size_t buckets)
+  {
+    size_t capacity = ht[0].capacity();
+    while (buckets-- > 0 && (size_t)rehash_index < capacity)
+    {
+      ht[0].migrate_bucket(rehash_index, ht[1]);
+      rehash_index++;
+    }
+    if ((size_t)rehash_index == capacity)
+    {
+      shrink_finished |= ht[1].capacity() < capacity;
+      // Handing a large array back to the OS isn't free either, so leave
+      // that to the cron instead of the command that finished the rehash.
+      retired.push_back(std::move(ht[0]));
+      ht[0] = std::move(ht[1]);
+      rehash_index = -1;
+    }
+  }
+};
+
+struct Client
+{
+  int fd;
+  uint64_t id;              // distinguishes this client from later ones reusing fd
+  long last_active;         // monotonic ms of the last read or write
+  std::string in;           // bytes read but not yet parsed into commands
+  std::string out;          // responses not yet written to the socket
+  size_t out_pos = 0;       // how much of out has already been sent
+  bool want_write = false;  // whether EPOLLOUT is registered
+  bool quitting = false;    // sent QUIT, close once out has been written
+};
+
+// Idle timeouts are tracked with a hashed timing wheel: each client sits
+// in the slot of the second its timeout would fire. Activity only bumps
+// last_active, it never touches the wheel, so the cost per read or write
+// stays O(1). When a slot comes due each entry is either expired, dropped
+// (the client is gone), or moved to the slot of its real deadline.
+class TimingWheel
+{
+public:
+  struct Entry
+  {
+    int fd;
+    uint64_t id;
+  };
+
+  void schedule(long deadline, Entry entry)
+  {
+    slots[deadline & (WHEEL_SLOTS - 1)].push_back(entry);
+  }
+
+  // Call fn(entry, tick) for every entry of every tick up to now; fn
+  // decides whether to reschedule it.
+  template <typename F>
+  void advance(long now, F &&fn)
+  {
+    if (current == 0)
+    {
+      current = now;
+    }
+    // Never spin over more than one full turn, e.g. after a long stall.
+    if (now - current >= WHEEL_SLOTS)
+    {
+      current = now - WHEEL_SLOTS + 1;
+    }
+    for (; current <= now; current++)
+    {
+      std::vector<Entry> due;
+      due.swap(slots[current & (WHEEL_SLOTS - 1)]);
+      for (const Entry &entry : due)
+      {
+        fn(entry, current);
+      }
+    }
+  }
+
+private:
+  std::vector<Entry> slots[WHEEL_SLOTS];
+  long current = 0; // next tick to process
+};
+
+struct Config
+{
+  int port = DEFAULT_PORT;
+  size_t max_clients = DEFAULT_MAX_CLIENTS;
+  long idle_timeout = DEFAULT_IDLE_TIMEOUT;   // seconds, 0 disables
+  size_t output_limit = DEFAULT_OUTPUT_LIMIT; // bytes, 0 disables
+};
+
+class Server
+{
+public:
+  Server(const Config &config, int listen_fd, int epoll_fd)
+      : config(config), listen_fd(listen_fd), epoll_fd(epoll_fd)
+  {
+    // Keep a descriptor in reserve so that, when we run out, we can still
+    // accept a pending connection just to tell it to go away.
+    reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+
+  void run()
+  {
+    epoll_event events[MAX_EVENTS];
+    while (keep_running)
+    {
+      int n = epoll_wait(epoll_fd, events, MAX_EVENTS, CRON_INTERVAL_MS);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        perror("epoll_wait");
+        exit(EXIT_FAILURE);
+      }
+      now_ms = monotonic_ms();
+      now = now_ms / 1000;
+
+      for (int i = 0; i < n; i++)
+      {
+        int fd = events[i].data.fd;
+        if (fd == listen_fd)
+        {
+          accept_clients();
+          continue;
+        }
+        Client *client = lookup(fd);
+        if (client == nullptr)
+        {
+          continue; // closed earlier in this batch
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+        {
+          close_client(client);
+          continue;
+        }
+        if (events[i].events & EPOLLIN)
+        {
+          if (!handle_readable(client))
+          {
+            close_client(client);
+            continue;
+          }
+        }
+        if (events[i].events & EPOLLOUT)
+        {
+          if (!flush(client))
+          {
+            close_client(client);
+          }
+        }
+      }
+
+      if (now_ms - last_cron_ms >= CRON_INTERVAL_MS)
+      {
+        last_cron_ms = now_ms;
+        cron();
+      }
+    }
+
+    for (auto &client : clients)
+    {
+      if (client)
+      {
+        close(client->fd);
+      }
+    }
+  }
+
+private:
+  Config config;
+  int listen_fd;
+  int epoll_fd;
+  int reserve_fd;
+  std::vector<std::unique_ptr<Client>> clients; // indexed by fd
+  size_t client_count = 0;
+  uint64_t next_client_id = 0;
+  TimingWheel idle_wheel;
+  long now = 0;    // monotonic seconds, refreshed once per loop iteration
+  long now_ms = 0;
+  long last_cron_ms = 0;
+  long last_command_ms = 0;
+  bool trim_pending = false; // a shrink finished since the last malloc_trim
+  Dict db;
+
+  Client *lookup(int fd)
+  {
+    if ((size_t)fd >= clients.size())
+    {
+      return nullptr;
+    }
+    return clients[fd].get();
+  }
+
+  void cron()
+  {
+    trim_pending |= db.cron(CRON_REHASH_US);
+    // Slot arrays go straight back to the OS, but freed items only do with
+    // malloc_trim, which walks every free chunk and can take tens of
+    // milliseconds after mass deletes. Wait until commands stop arriving
+    // rather than stall clients; under load SETs reuse that memory anyway.
+    if (trim_pending && now_ms - last_command_ms >= CRON_INTERVAL_MS)
+    {
+      malloc_trim(0);
+      trim_pending = false;
+    }
+    if (config.idle_timeout > 0)
+    {
+      idle_wheel.advance(now, [&](const TimingWheel::Entry &entry, long tick)
+                         { check_idle(entry, tick); });
+    }
+  }
+
+  void check_idle(const TimingWheel::Entry &entry, long tick)
+  {
+    Client *client = lookup(entry.fd);
+    if (client == nullptr || client->id != entry.id)
+    {
+      return; // closed since it was scheduled
+    }
+    // Compare in milliseconds: with whole seconds a client could be
+    // dropped up to a second before it had really been idle that long.
+    long deadline_ms = client->last_active + config.idle_timeout * 1000;
+    if (deadline_ms <= now_ms)
+    {
+      close_client(client);
+      return;
+    }
+    // Check again on the first tick at or after the deadline; deadlines
+    // further out than one turn come back around until due.
+    long deadline = (deadline_ms + 999) / 1000;
+    idle_wheel.schedule(std::min(deadline, tick + WHEEL_SLOTS), entry);
+  }
+
+  // Accept at most MAX_ACCEPTS_PER_CALL connections, so a connection
+  // storm can't starve clients that are already connected; anything left
+  // in the backlog keeps the listening socket readable for the next round.
+  void accept_clients()
+  {
+    for (int i = 0; i < MAX_ACCEPTS_PER_CALL; i++)
+    {
+      int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+      {
+        if (errno == EMFILE || errno == ENFILE)
+        {
+          reject_without_descriptors();
+        }
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+                 errno != ECONNABORTED)
+        {
+          perror("accept");
+        }
+        return;
+      }
+
+      if (client_count >= config.max_clients)
+      {
+        reject(fd);
+        continue;
+      }
+
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+      {
+        perror("epoll_ctl");
+        close(fd);
+        continue;
+      }
+      if ((size_t)fd >= clients.size())
+      {
+        clients.resize(fd + 1);
+      }
+      clients[fd] = std::make_unique<Client>();
+      Client *client = clients[fd].get();
+      client->fd = fd;
+      client->id = next_client_id++;
+      client->last_active = now_ms;
+      client_count++;
+      if (config.idle_timeout > 0)
+      {
+        idle_wheel.schedule(now + config.idle_timeout + 1, {fd, client->id});
+      }
+    }
+  }
+
+  static void reject(int fd)
+  {
+    static const char message[] = "ERR max number of clients reached\n";
+    send(fd, message, sizeof(message) - 1, MSG_NOSIGNAL);
+    close(fd);
+  }
+
+  // Out of file descriptors: free the reserved one, use it to accept and
+  // reject one pending connection, then take it back. Without this the
+  // listening socket stays readable and the loop spins on EMFILE.
+  void reject_without_descriptors()
+  {
+    if (reserve_fd < 0)
+    {
+      return;
+    }
+    close(reserve_fd);
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0)
+    {
+      reject(fd);
+    }
+    reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+
+  void close_client(Client *client)
+  {
+    int fd = client->fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients[fd].reset();
+    client_count--;
+  }
+
+  // Read what's available and run every complete command in it. Return
+  // false if the connection should be closed.
+  bool handle_readable(Client *client)
+  {
+    char buffer[READ_CHUNK];
+    ssize_t res = read(client->fd, buffer, sizeof(buffer));
+    if (res == 0)
+    {
+      return false;
+    }
+    if (res < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client->last_active = now_ms;
+    if (client->quitting)
+    {
+      return true; // only waiting for the replies before QUIT to drain
+    }
+    client->in.append(buffer, res);
+    last_command_ms = now_ms;
+
+    size_t start = 0;
+    while (true)
+    {
+      size_t newline = client->in.find('\n', start);
+      if (newline == std::string::npos)
+      {
+        break;
+      }
+      std::string_view line(client->in.data() + start, newline - start);
+      start = newline + 1;
+      if (!line.empty() && line.back() == '\r')
+      {
+        line.remove_suffix(1);
+      }
+      execute(client, line);
+      if (client->quitting)
+      {
+        break;
+      }
+      // A client pipelining commands without reading the replies would
+      // otherwise make us buffer without bound.
+      if (config.output_limit > 0 &&
+          client->out.size() - client->out_pos > config.output_limit)
+      {
+        return false;
+      }
+    }
+    client->in.erase(0, start);
+    if (client->in.size() > MAX_INLINE)
+    {
+      return false;
+    }
+    return flush(client);
+  }
+
+  // Write as much of the pending output as the socket takes, and
+  // (un)register interest in writability accordingly. Return false if the
+  // connection should be closed, including once a quitting client's
+  // replies are all written.
+  bool flush(Client *client)
+  {
+    while (client->out_pos < client->out.size())
+    {
+      ssize_t res = send(client->fd, client->out.data() + client->out_pos,
+                         client->out.size() - client->out_pos, MSG_NOSIGNAL);
+      if (res < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          break;
+        }
+        return false;
+      }
+      client->out_pos += res;
+      client->last_active = now_ms;
+    }
+
+    bool pending = client->out_pos < client->out.size();
+    if (!pending && client->quitting)
+    {
+      return false;
+    }
+    if (!pending)
+    {
+      client->out.clear();
+      client->out_pos = 0;
+      if (client->out.capacity() > OUTPUT_COMPACT_THRESHOLD)
+      {
+        std::string().swap(client->out); // don't pin a burst's worth of memory
+      }
+    }
+    else if (client->out_pos >= OUTPUT_COMPACT_THRESHOLD &&
+             client->out_pos >= client->out.size() / 2)
+    {
+      // A reader that never quite catches up would otherwise keep the
+      // sent prefix alive forever. Dropping it once it is at least half
+      // the buffer keeps the copying amortized O(1) per byte and caps the
+      // buffer at about twice the unsent bytes the output limit allows.
+      client->out.erase(0, client->out_pos);
+      client->out_pos = 0;
+    }
+    if (pending != client->want_write)
+    {
+      epoll_event event = {};
+      event.events = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+      event.data.fd = client->fd;
+      epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+      client->want_write = pending;
+    }
+    return true;
+  }
+
+  static std::vector<std::string_view> split(std::string_view line)
+  {
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    while (start < line.size())
+    {
+      size_t end = line.find(' ', start);
+      if (end == std::string_view::npos)
+      {
+        end = line.size();
+      }
+      if (end > start)
+      {
+        parts.push_back(line.substr(start, end - start));
+      }
+      start = end + 1;
+    }
+    return parts;
+  }
+
+  // Match c against the single pattern element at *p (anything but '*'),
+  // advancing *p past the element on success.
+  static bool match_one(std::string_view pattern, size_t *p, char c)
+  {
+    size_t i = *p;
+    if (pattern[i] == '?')
+    {
+      *p = i + 1;
+      return true;
+    }
+    if (pattern[i] == '\\' && i + 1 < pattern.size())
+    {
+      *p = i + 2;
+      return pattern[i + 1] == c;
+    }
+    if (pattern[i] != '[')
+    {
+      *p = i + 1;
+      return pattern[i] == c;
+    }
+
+    i++;
+    bool negate = i < pattern.size() && pattern[i] == '^';
+    if (negate)
+    {
+      i++;
+    }
+    bool matched = false;
+    while (i < pattern.size() && pattern[i] != ']')
+    {
+      if (pattern[i] == '\\' && i + 1 < pattern.size())
+      {
+        matched |= pattern[i + 1] == c;
+        i += 2;
+      }
+      else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+      {
+        char low = std::min(pattern[i], pattern[i + 2]);
+        char high = std::max(pattern[i], pattern[i + 2]);
+        matched |= c >= low && c <= high;
+        i += 3;
+      }
+      else
+      {
+        matched |= pattern[i] == c;
+        i++;
+      }
+    }
+    if (i < pattern.size())
+    {
+      i++; // closing ']'
+    }
+    *p = i;
+    return matched != negate;
+  }
+
+  // Glob-style match supporting *, ?, [abc], [^a-z] and backslash escapes.
+  // Only the latest '*' is ever backtracked to, which keeps matching
+  // O(pattern * string) instead of exponential.
+  static bool glob_match(std::string_view pattern, std::string_view string)
+  {
+    size_t p = 0;
+    size_t s = 0;
+    size_t star = std::string_view::npos;
+    size_t star_s = 0;
+    while (s < string.size())
+    {
+      if (p < pattern.size() && pattern[p] == '*')
+      {
+        star = p++;
+        star_s = s;
+        continue;
+      }
+      size_t next = p;
+      if (p < pattern.size() && match_one(pattern, &next, string[s]))
+      {
+        p = next;
+        s++;
+        continue;
+      }
+      if (star == std::string_view::npos)
+      {
+        return false;
+      }
+      p = star + 1;
+      s = ++star_s;
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+      p++;
+    }
+    return p == pattern.size();
+  }
+
+  // SCAN cursor [MATCH pattern] [COUNT count]
+  //
+  // Replies with the next cursor followed by the keys found, on one line.
+  // Each call looks at roughly count entries and at most 10 * count
+  // buckets (plus the few buckets of a final cursor step mid-rehash)
+  // before filtering with MATCH, so it never stalls the loop for other
+  // clients however large the keyspace is.
+  void scan(const std::vector<std::string_view> &parts, std::string &out)
+  {
+    uint64_t cursor;
+    if (parts.size() < 2 || !parse_number(parts[1], &cursor))
+    {
+      out += "ERR invalid cursor\n";
+      return;
+    }
+    std::string_view pattern;
+    long long count = SCAN_DEFAULT_COUNT;
+    for (size_t i = 2; i < parts.size(); i += 2)
+    {
+      if (i + 1 >= parts.size())
+      {
+        out += "ERR syntax error\n";
+        return;
+      }
+      if (parts[i] == "MATCH")
+      {
+        pattern = parts[i + 1];
+      }
+      else if (parts[i] == "COUNT")
+      {
+        if (!parse_number(parts[i + 1], &count) || count < 1)
+        {
+          out += "ERR value is not an integer or out of range\n";
+          return;
+        }
+        count = std::min(count, SCAN_MAX_COUNT);
+      }
+      else
+      {
+        out += "ERR syntax error\n";
+        return;
+      }
+    }
+    bool match_all = pattern.empty() || pattern == "*";
+
+    std::string keys;
+    long long seen = 0;
+    size_t buckets = 0;
+    do
+    {
+      cursor = db.scan(cursor, [&](const std::string &key)
+                       {
+                         seen++;
+                         if (match_all || glob_match(pattern, key))
+                         {
+                           keys += ' ';
+                           keys += key;
+                         } },
+                       &buckets);
+    } while (cursor != 0 && seen < count && buckets < (size_t)count * 10);
+
+    out += std::to_string(cursor);
+    out += keys;
+    out += '\n';
+  }
+
+  // Run one command line and queue its response.
+  void execute(Client *client, std::string_view line)
+  {
+    std::vector<std::string_view> parts = split(line);
+    if (parts.empty())
+    {
+      return;
+    }
+    std::string_view command = parts[0];
+    std::string &out = client->out;
+
+    if (command == "GET")
+    {
+      if (parts.size() != 2)
+      {
+        out += "ERR wrong number of arguments for 'get' command\n";
+        return;
+      }
+      const std::string *value = db.get(parts[1]);
+      if (value != nullptr)
+      {
+        out += *value;
+      }
+      out += '\n';
+    }
+    else if (command == "SET")
+    {
+      if (parts.size() != 3)
+      {
+        out += "ERR wrong number of arguments for 'set' command\n";
+        return;
+      }
+      db.set(parts[1], std::string(parts[2]));
+      out += "OK\n";
+    }
+    else if (command == "DEL")
+    {
+      if (parts.size() != 2)
+      {
+        out += "ERR wrong number of arguments for 'del' command\n";
+        return;
+      }
+      out += db.del(parts[1]) ? "1\n" : "0\n";
+    }
+    else if (command == "INCR")
+    {
+      if (parts.size() != 2)
+      {
+        out += "ERR wrong number of arguments for 'incr' command\n";
+        return;
+      }
+      long long current = 0;
+      const std::string *existing = db.get(parts[1]);
+      if (existing != nullptr && (!parse_number(*existing, &current) || current == INT64_MAX))
+      {
+        out += "ERR value is not an integer or out of range\n";
+        return;
+      }
+      std::string next = std::to_string(current + 1);
+      out += next;
+      out += '\n';
+      db.set(parts[1], std::move(next));
+    }
+    else if (command == "SCAN")
+    {
+      scan(parts, out);
+    }
+    else if (command == "QUIT")
+    {
+      // Replies to commands pipelined before QUIT still go out, the
+      // connection is closed once flush has written them.
+      client->quitting = true;
+    }
+    else
+    {
+      out += "ERR unknown command\n";
+    }
+  }
+};
+
+static void usage(const char *program)
+{
+  fprintf(stderr, "usage: %s [port] [--maxclients n] [--timeout seconds] [--output-limit bytes]\n",
+          program);
+  exit(1);
+}
+
+// Parse the value of option, exiting with an error naming the option if
+// it isn't an integer between min and max.
+static long long option_value(const char *option, const char *value, long long min, long long max)
+{
+  long long result;
+  if (!parse_number(value, &result) || result < min || result > max)
+  {
+    fprintf(stderr, "invalid value for %s: '%s', expected an integer between %lld and %lld\n",
+            option, value, min, max);
+    exit(1);
+  }
+  return result;
+}
+
+// Parse `server [port] [--option value]...`; the bare port comes first so
+// the test helper can keep starting every server as `server PORT`.
+static Config parse_config(int argc, char **argv)
+{
+  Config config;
+  int i = 1;
+  if (i < argc && argv[i][0] != '-')
+  {
+    config.port = option_value("port", argv[i++], 1, 65535);
+  }
+  for (; i < argc; i += 2)
+  {
+    const char *option = argv[i];
+    if (i + 1 >= argc && strncmp(option, "--", 2) == 0)
+    {
+      fprintf(stderr, "missing value for %s\n", option);
+      usage(argv[0]);
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : "";
+    if (strcmp(option, "--maxclients") == 0)
+    {
+      config.max_clients = option_value(option, value, 1, INT_MAX);
+    }
+    else if (strcmp(option, "--timeout") == 0)
+    {
+      config.idle_timeout = option_value(option, value, 0, MAX_IDLE_TIMEOUT);
+    }
+    else if (strcmp(option, "--output-limit") == 0)
+    {
+      config.output_limit = option_value(option, value, 0, LLONG_MAX);
+    }
+    else
+    {
+      fprintf(stderr, "unknown option: %s\n", option);
+      usage(argv[0]);
+    }
+  }
+  return config;
+}
+
+// Make sure the process may open enough descriptors for max_clients plus
+// a few of our own, lowering max_clients if the hard limit won't allow it.
+static void adjust_open_files_limit(Config &config)
+{
+  static constexpr rlim_t RESERVED_FDS = 32; // listener, epoll, stdio, reserve...
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+  {
+    return;
+  }
+  rlim_t wanted = config.max_clients + RESERVED_FDS;
+  if (limit.rlim_cur >= wanted)
+  {
+    return;
+  }
+  limit.rlim_cur = std::min(wanted, limit.rlim_max);
+  if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+  {
+    getrlimit(RLIMIT_NOFILE, &limit);
+  }
+  if (limit.rlim_cur < wanted)
+  {
+    config.max_clients = limit.rlim_cur > RESERVED_FDS ? limit.rlim_cur - RESERVED_FDS : 1;
+    printf("Open files limit is %lu, maxclients lowered to %zu\n",
+           (unsigned long)limit.rlim_cur, config.max_clients);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Config config = parse_config(argc, argv);
+  adjust_open_files_limit(config);
+  int port = config.port;
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0)
+  {
+    perror("socket");
+    exit(1);
+  }
+  int one = 1;
+  if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0)
+  {
+    perror("setsockopt(SO_REUSEADDR) failed");
+    exit(1);
+  }
+
+  sockaddr_in server_address;
+  memset(&server_address, 0, sizeof(server_address));
+  server_address.sin_family = AF_INET;
+  server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+  server_address.sin_port = htons(port);
+
+  if (bind(listen_fd, (sockaddr *)&server_address, sizeof(server_address)) != 0)
+  {
+    perror("bind");
+    exit(1);
+  }
+  if (listen(listen_fd, SOMAXCONN) != 0)
+  {
+    perror("listen");
+    exit(1);
+  }
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0)
+  {
+    perror("epoll_create1");
+    exit(1);
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = listen_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0)
+  {
+    perror("epoll_ctl");
+    exit(1);
+  }
+
+  signal(SIGINT, int_handler);
+  signal(SIGPIPE, SIG_IGN);
+  printf("Server listening on port %d\n", port);
+  fflush(stdout);
+
+  Server server(config, listen_fd, epoll_fd);
+  server.run();
+
+  printf("Graceful close\n");
+  close(epoll_fd);
+  close(listen_fd);
+  return 0;
 }
@@ -0,0 +1,78 @@
+# frozen_string_literal: true
+
+# How to build and start each implementation. Shared by the test suite and
+# `rake bench`. "release_build" and "release_start", when present, are
+# used by the benchmarks instead of "build" and "start".
+
+require "socket"
+require "timeout"
+
+PORT = "3000"
+
+SERVER_CONFIGS = {
+  "c" => {
+    "build" => "(cd c && make clean && make)",
+    "start" => ["./c/server"],
+    "release_build" => "(cd c && make clean && make CFLAGS='-Wall -O2')",
+  },
+  "cpp" => {
+    "build" => "(cd cpp && make clean && make)",
+    "start" => ["./cpp/server"],
+    "release_build" => "(cd cpp && make clean && make CXXFLAGS=-O2)",
+  },
+  "ruby" => {
+    "build" => nil,
+    "start" => ["ruby", "ruby/server.rb"],
+  },
+  "python" => {
+    "build" => nil,
+    "start" => ["python3", "python/server.py"],
+  },
+  "go" => {
+    "build" => "go build -o ./go/server go/server.go",
+    "start" => ["./go/server"],
+  },
+  "node" => {
+    "build" => nil,
+    "start" => ["node", "node/server.js"],
+  },
+  "rust" => {
+    "build" => "(cd rust && cargo build)",
+    "start" => ["./rust/target/debug/tcp"],
+    "release_build" => "(cd rust && cargo build --release)",
+    "release_start" => ["./rust/target/release/tcp"],
+  },
+  "kotlin" => {
+    "build" => "(cd kotlin && gradle clean && gradle fatJar)",
+    "start" => ["java", "-jar", "kotlin/build/libs/kotlin-1.0-SNAPSHOT-standalone.jar"],
+  },
+  "java" => {
+    "build" => "(cd java && javac -d . tcp-server/src/main/java/main/Main.java && jar cfe Main.jar main.Main main/Main.class)",
+    "start" => %w[java -jar java/Main.jar],
+  },
+  "clojure" => {
+    "build" => "(cd clojure && lein uberjar)",
+    "start" => ["java", "-jar", "clojure/target/uberjar/tcp-server-0.1.0-SNAPSHOT-standalone.jar"],
+  },
+  "zig" => {
+    "build" => "(cd zig && zig build-exe src/main.zig)",
+    "release_build" => "(cd zig && zig build-exe -O ReleaseFast src/main.zig)",
+    "start" => ["./zig/main"],
+  },
+}
+
+# Block until the server on PORT answers a GET, raise Timeout::Error if it
+# doesn't within timeout seconds.
+def wait_for_server(timeout: 2)
+  Timeout.timeout(timeout) do
+    loop do
+      socket = TCPSocket.new("localhost", PORT)
+      socket.puts("GET a")
+      socket.gets
+      socket.close
+      break
+    rescue Errno::ECONNREFUSED, Errno::ECONNRESET
+      sleep 0.001
+    end
+  end
+end
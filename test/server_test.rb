@@ -57,6 +57,46 @@ describe "A server" do
     end
   end
 
+  it "keeps every key through grows and shrinks" do
+    with_server do
+      connect_to_server do |s|
+        expected = {}
+
+        # Enough keys for the table to grow several times.
+        4000.times do |i|
+          s.puts("SET key:#{ i } v#{ i }")
+          assert_equal "OK\n", s.gets
+          expected["key:#{ i }"] = "v#{ i }"
+        end
+
+        # Deleting nine keys in ten drops the load far enough to shrink,
+        # and the re-SETs land while those shrinks are still migrating.
+        4000.times do |i|
+          next if i % 10 == 0
+
+          s.puts("DEL key:#{ i }")
+          assert_equal "1\n", s.gets
+          expected.delete("key:#{ i }")
+          next unless i % 50 == 1
+
+          s.puts("SET key:#{ i } again#{ i }")
+          assert_equal "OK\n", s.gets
+          expected["key:#{ i }"] = "again#{ i }"
+        end
+
+        4000.times do |i|
+          key = "key:#{ i }"
+          s.puts("GET #{ key }")
+          assert_equal "#{ expected[key] }\n", s.gets
+          next if expected.key?(key)
+
+          s.puts("DEL #{ key }")
+          assert_equal "0\n", s.gets
+        end
+      end
+    end
+  end
+
   it "responds to INCR" do
     with_server do
       connect_to_server do |s|
@@ -78,6 +118,93 @@ describe "A server" do
     end
   end
 
+  it "responds to SCAN" do
+    skip_unless_cpp("SCAN")
+
+    with_server do
+      connect_to_server do |s|
+        keys = 100.times.map { |i| "key:#{ i }" }
+        keys.each do |key|
+          s.puts("SET #{ key } v")
+          assert_equal "OK\n", s.gets
+        end
+
+        seen = []
+        cursor = "0"
+        loop do
+          s.puts("SCAN #{ cursor } MATCH key:* COUNT 5")
+          cursor, *found = s.gets.split
+          seen.concat(found)
+
+          # Grow the table under the cursor, keys present from start to end
+          # must still all be returned.
+          s.puts("SET other:#{ seen.size } v")
+          assert_equal "OK\n", s.gets
+          break if cursor == "0"
+        end
+        assert_equal keys.sort, seen.uniq.sort
+
+        s.puts("SCAN 0 MATCH nope:* COUNT 1000")
+        assert_equal "0\n", s.gets
+
+        s.puts("SCAN abc")
+        assert_equal "ERR invalid cursor\n", s.gets
+      end
+    end
+  end
+
+  it "rejects clients past --maxclients" do
+    skip_unless_cpp("--maxclients")
+
+    with_server("--maxclients", "2") do
+      # Once both are admitted wait_for_server's probe can't be holding a
+      # slot anymore, so the limit is reached by these two alone.
+      admitted = 2.times.map { connect_admitted }
+
+      connect_to_server do |c|
+        assert_equal "ERR max number of clients reached\n", c.gets
+        assert_closed_by_server c
+      end
+    ensure
+      admitted&.each(&:close)
+    end
+  end
+
+  it "closes idle clients after --timeout" do
+    skip_unless_cpp("--timeout")
+
+    with_server("--timeout", "1") do
+      connect_to_server do |s|
+        s.puts("GET a")
+        assert_equal "\n", s.gets
+
+        # Not idle for a full second yet, the connection must still work.
+        sleep 0.9
+        s.puts("GET a")
+        assert_equal "\n", s.gets
+
+        idle_since = Time.now
+        assert_closed_by_server s, within: 3
+        assert_operator Time.now - idle_since, :>=, 1
+      end
+    end
+  end
+
+  it "closes clients whose output exceeds --output-limit" do
+    skip_unless_cpp("--output-limit")
+
+    with_server("--output-limit", "1000") do
+      connect_to_server do |s|
+        s.puts("SET big #{ 'x' * 900 }")
+        assert_equal "OK\n", s.gets
+
+        # Pipeline without reading, the second reply goes past the limit.
+        s.write("GET big\n" * 20)
+        assert_closed_by_server s
+      end
+    end
+  end
+
   it "respond to QUIT" do
     with_server do
       connect_to_server do |s|
@@ -88,6 +215,17 @@ describe "A server" do
     end
   end
 
+  it "sends the replies pipelined before QUIT" do
+    skip_unless_cpp("Pipelined QUIT")
+
+    with_server do
+      connect_to_server do |s|
+        s.write("SET a 1\nGET a\nQUIT\nGET a\n")
+        assert_equal "OK\n1\n", s.read
+      end
+    end
+  end
+
   it "handles multiple clients" do
     with_server do
       socket = nil
@@ -115,6 +253,43 @@ describe "A server" do
 
   private
 
+  def skip_unless_cpp(feature)
+    skip "#{ feature } is only implemented by the cpp server" unless ENV["SERVER"]&.downcase == "cpp"
+  end
+
+  # Open a connection, retrying while the server rejects it for being at
+  # --maxclients, e.g. because it hasn't yet noticed an earlier client left.
+  def connect_admitted(within: 2)
+    deadline = Time.now + within
+    loop do
+      socket = TCPSocket.new("localhost", 3000)
+      begin
+        socket.puts("GET a")
+        return socket if socket.gets == "\n"
+      rescue Errno::ECONNRESET, Errno::EPIPE
+        # Rejected before our GET was read, the reset can beat the reply.
+      end
+
+      socket.close
+      flunk "server kept rejecting connections for #{ within }s" if Time.now > deadline
+    end
+  end
+
+  # Read until the server closes the connection, failing if that doesn't
+  # happen within the given number of seconds.
+  def assert_closed_by_server(socket, within: 1)
+    deadline = Time.now + within
+    loop do
+      remaining = deadline - Time.now
+      flunk "server did not close the connection within #{ within }s" if remaining <= 0
+      next unless socket.wait_readable(remaining)
+
+      socket.readpartial(4096)
+    end
+  rescue EOFError, Errno::ECONNRESET
+    pass
+  end
+
   def connect_to_server
     retried = false unless retried
     socket = TCPSocket.new "localhost", 3000
@@ -128,10 +303,10 @@ describe "A server" do
     socket.close if socket
   end
 
-  def with_server
+  def with_server(*server_args)
     pid = nil
     Timeout.timeout(10) do
-      pid = start_server
+      pid = start_server(*server_args)
       wait_for_server
 
       yield
@@ -141,23 +316,9 @@ describe "A server" do
     Process.wait(pid)
   end
 
-  def start_server
-    args = SERVER_CONFIG["start"] + [PORT]
+  def start_server(*server_args)
+    args = SERVER_CONFIG["start"] + [PORT] + server_args
     LOG.debug "Starting server with #{ args }"
     spawn(*args, STDOUT => "/dev/null", STDERR => "/dev/null")
   end
-
-  def wait_for_server
-    Timeout.timeout(2) do
-      loop do
-        socket = TCPSocket.new("localhost", 3000)
-        socket.puts("GET a")
-        socket.gets
-        socket.close
-        break
-      rescue Errno::ECONNREFUSED => _e
-        sleep 0.001
-      end
-    end
-  end
 end